@@ -26,12 +26,16 @@
 // mips-specific datatypes
 using namespace mips_parms;
 
+//!In mips_isa.cpp: stops instruction fusion once a debugger is attached.
+extern bool mips_gdb_attached;
+
 int mips::nRegs(void) {
    return 73;
 }
 
 
 ac_word mips::reg_read( int reg ) {
+  mips_gdb_attached = true;
   /* general purpose registers */
   if ( ( reg >= 0 ) && ( reg < 32 ) )
     return RB.read( reg );
@@ -51,6 +55,7 @@ ac_word mips::reg_read( int reg ) {
 
 
 void mips::reg_write( int reg, ac_word value ) {
+  mips_gdb_attached = true;
   /* general purpose registers */
   if ( ( reg >= 0 ) && ( reg < 32 ) )
     RB.write( reg, value );
@@ -68,10 +73,12 @@ void mips::reg_write( int reg, ac_word value ) {
 
 
 unsigned char mips::mem_read( unsigned int address ) {
+  mips_gdb_attached = true;
   return IM->read_byte( address );
 }
 
 
 void mips::mem_write( unsigned int address, unsigned char byte ) {
+  mips_gdb_attached = true;
   IM->write_byte( address, byte );
 }
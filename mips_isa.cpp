@@ -23,6 +23,33 @@
 #include  "mips_isa.H"
 #include  "mips_isa_init.cpp"
 #include  "mips_bhv_macros.H"
+#include  "mips_decoder.H"
+#include  <stdio.h>
+#include  <stdlib.h>
+#include  <string.h>
+#include  <time.h>
+#include  <unistd.h>
+#include  <atomic>
+#ifdef __linux__
+#include  <sys/syscall.h>
+#include  <linux/membarrier.h>
+#endif
+
+//If you want cycle-approximate timing, build with -DTIMING_MODEL
+#ifdef TIMING_MODEL
+#include  "mips_timing.H"
+#endif
+
+//If you want live statistics in shared memory, build with -DLIVE_STATS
+#ifdef LIVE_STATS
+#include  "mips_live_stats.H"
+#endif
+
+//Instruction traces (see mips_trace.H) are off until MIPS_TRACE is set.
+//Build with -DNO_INSTR_TRACE to leave the tracer out.
+#ifndef NO_INSTR_TRACE
+#include  "mips_trace.H"
+#endif
 
 
 //If you want debug information for this model, uncomment next line
@@ -41,21 +68,321 @@ using namespace mips_parms;
 static int processors_started = 0;
 #define DEFAULT_STACK_SIZE (256*1024)
 
+//!Per-core model state is indexed by the id register.
+#define MAX_CORES 64
+#define CORE (id.read() % MAX_CORES)
+
+#ifdef TIMING_MODEL
+static mips_timing timing[MAX_CORES];
+
+//!Pass pending cycles to SystemC (when advance is set) and charge the
+//!pending stall cycles to the core's power_stats.
+static void timing_sync(mips_timing& t, unsigned core, bool advance)
+{
+  if (advance)
+    sc_core::wait(sc_core::sc_time((double) t.pending_cycles * TIMING_CYCLE_NS, sc_core::SC_NS));
+#ifdef POWER_SIM
+  if (core < power_stats::instances().size())
+    power_stats::instances()[core]->update_stall_power(t.pending_stalls);
+#endif
+  t.pending_cycles = t.pending_stalls = 0;
+}
+
+#define TIMING_INSTR(instr_id, pc) {                                \
+    mips_timing& t = timing[CORE];                                  \
+    if (t.enabled) {                                                \
+      t.instr(instr_id, pc);                                        \
+      if (t.quantum_reached())                                      \
+        timing_sync(t, CORE, true);                                 \
+    } }
+#define TIMING_LOAD(a)  { if (timing[CORE].enabled) timing[CORE].load(a); }
+#define TIMING_STORE(a) { if (timing[CORE].enabled) timing[CORE].store(a); }
+#else
+#define TIMING_INSTR(instr_id, pc)
+#define TIMING_LOAD(a)
+#define TIMING_STORE(a)
+#endif
+
+//!LL/SC reservations, one per core, at the granularity of a DC block of
+//!mips_block.ac. A reservation holds its line address | 1, 0 when none.
+//!ll publishes its reservation before it loads, and a store breaks the
+//!other cores' reservations on the line only after its write returned,
+//!so an ll either loads the stored value or loses its reservation. sc
+//!holds llsc_lock from its check through its write and the break, so no
+//!ll can load the old value and keep its reservation in between. The
+//!state is atomic so cores on parallel host threads may share it. Until
+//!the first ll of the run, a store only reads llsc_cores; after it, a
+//!store also fences and reads reservations_held.
+#define LLSC_LINE_SIZE 32
+#define LLSC_TAG(a)    (((a) & ~(uint32_t) (LLSC_LINE_SIZE - 1)) | 1)
+
+static std::atomic<uint32_t> reservation[MAX_CORES];
+static std::atomic<unsigned> reservations_held(0);
+static std::atomic<unsigned> llsc_cores(0);          // highest core using ll + 1
+static std::atomic_flag llsc_lock = ATOMIC_FLAG_INIT;
+
+//!Notified when sc releases llsc_lock. Built on first use, inside the
+//!simulation.
+static sc_core::sc_event& llsc_unlocked()
+{
+  static sc_core::sc_event e;
+  return e;
+}
+
+//!Run by the ll that raises llsc_cores from 0. Stores before it skipped
+//!the fence; a barrier on every thread of the process orders them before
+//!the reservation this ll publishes. Only cores on parallel host threads
+//!need it: SystemC runs all cores on one.
+static void llsc_first_use()
+{
+#if defined(__linux__) && defined(SYS_membarrier)
+  syscall(SYS_membarrier, MEMBARRIER_CMD_SHARED, 0);
+#endif
+}
+
+//!Break the reservations other cores hold on the line of addr.
+static void llsc_break(unsigned core, uint32_t addr)
+{
+  uint32_t tag = LLSC_TAG(addr);
+  unsigned cores = llsc_cores.load(std::memory_order_acquire);
+
+  for (unsigned c = 0; c < cores; c++) {
+    uint32_t expected = tag;
+    if (c != core && reservation[c].load(std::memory_order_relaxed) == tag &&
+        reservation[c].compare_exchange_strong(expected, 0))
+      reservations_held--;
+  }
+}
+
+//!Called after every store, once the write is visible. The fence orders
+//!the write before the read of reservations_held, against an ll that
+//!publishes its reservation before it loads; programs that never run ll
+//!do not pay for it.
+#define LLSC_STORE(a) {                                             \
+    std::atomic_signal_fence(std::memory_order_seq_cst);            \
+    if (llsc_cores.load(std::memory_order_relaxed)) {               \
+      std::atomic_thread_fence(std::memory_order_seq_cst);          \
+      if (reservations_held.load(std::memory_order_relaxed))        \
+        llsc_break(CORE, a);                                        \
+    } }
+
+#ifdef LIVE_STATS
+//!Live statistics for external watchers, published every
+//!MIPS_LIVE_STATS_INTERVAL instructions when MIPS_LIVE_STATS is set.
+static mips_live_stats& live = live_stats();
+
+static void live_stats_update(unsigned core, unsigned long long instrs, uint32_t pc,
+                              live_stats_state state)
+{
+  int profile = -1;
+  double icache = -1, dcache = -1, energy = -1;
+#ifdef TIMING_MODEL
+  icache = timing[core].icache.hit_rate();
+  dcache = timing[core].dcache.hit_rate();
+#endif
+#ifdef POWER_SIM
+  if (core < power_stats::instances().size()) {
+    profile = power_stats::instances()[core]->getPowerState();
+    energy = power_stats::instances()[core]->get_total_energy_joules();
+  }
+#endif
+  live.publish(core, instrs, pc, profile, icache, dcache, energy, state);
+}
+
+#define LIVE_STATS_INSTR() {                                        \
+    if (ac_instr_counter >= live.next[CORE])                        \
+      live_stats_update(CORE, ac_instr_counter, ac_pc, LIVE_STATS_RUNNING); }
+#define LIVE_STATS_END() live_stats_update(CORE, ac_instr_counter, ac_pc, LIVE_STATS_FINISHED)
+#else
+#define LIVE_STATS_INSTR()
+#define LIVE_STATS_END()
+#endif
+
+#ifndef NO_INSTR_TRACE
+//!Run-time filtered instruction trace. Instructions before each core's
+//!first traced count cost one compare.
+static mips_trace tracer;
+
+#define TRACE_INSTR(count, pc, word) {                              \
+    if ((count) >= tracer.first[CORE])                              \
+      tracer.record(CORE, count, pc, word); }
+#else
+#define TRACE_INSTR(count, pc, word)
+#endif
+
+//!Address of the instruction being executed. The generic behavior saves
+//!it for the format behaviors, which run after ac_pc has moved on.
+static uint32_t instr_pc[MAX_CORES];
+
+#define INSTR_ISSUED(word) {                                        \
+    TIMING_INSTR(mips_decode_id(word), instr_pc[CORE]);             \
+    TRACE_INSTR(ac_instr_counter, instr_pc[CORE], word); }
+
+//!Region of interest markers: "break 30" and "break 31" in guest code.
+//!Statistics are snapshot at the first and reported at the second. With
+//!-DROI_FAST_FORWARD, code outside the region also runs without timing.
+#define ROI_BEGIN_CODE 30
+#define ROI_END_CODE   31
+
+struct roi_snapshot {
+  bool active;
+  unsigned long long instrs;
+  double time;
+  double energy;
+};
+
+static roi_snapshot roi[MAX_CORES];
+
+//!Host time when this file's static initializers ran, after the dynamic
+//!loader but before the simulator loads the application. With
+//!MIPS_STARTUP_TIME set, the begin behavior of the first core reports the
+//!time from it, and from process start, to the first instruction. This is
+//!instrumentation only: loading is done by the ArchC runtime, and an
+//!mmap-backed loader or prelinked image format would have to go there.
+static struct startup_clock {
+  struct timespec wall;
+  startup_clock() { clock_gettime(CLOCK_MONOTONIC, &wall); }
+} startup;
+
+//!Seconds since the process started, from the starttime field of
+//!/proc/self/stat (clock tick resolution), or -1 when not available.
+static double seconds_since_process_start()
+{
+#ifdef __linux__
+  char buf[1024];
+  FILE* f = fopen("/proc/self/stat", "r");
+  if (!f)
+    return -1;
+  size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+  fclose(f);
+  buf[n] = 0;
+
+  // Skip to the space before field 22, starttime, counting from the end
+  // of the command name (field 2), which may hold spaces and parentheses.
+  char* p = strrchr(buf, ')');
+  unsigned long long starttime;
+  if (!p)
+    return -1;
+  for (int field = 2; field < 22; field++)
+    if (!(p = strchr(p + 1, ' ')))
+      return -1;
+  if (sscanf(p, " %llu", &starttime) != 1)
+    return -1;
+
+  struct timespec now;
+  clock_gettime(CLOCK_BOOTTIME, &now);
+  return now.tv_sec + now.tv_nsec / 1e9 - (double) starttime / sysconf(_SC_CLK_TCK);
+#else
+  return -1;
+#endif
+}
+
+//!Execute common instruction pairs (lui+ori/addiu, lwl+lwr, swl+swr,
+//!slt/sltu+beq/bne, mult/multu+mflo) in a single dispatch. A GDB
+//!breakpoint on the second instruction of a pair would never be hit, so
+//!pairs stop fusing once a debugger has used the stub (see
+//!mips_gdb_funcs.cpp). Build with -DNO_FUSE_INSTR to never fuse.
+#ifndef NO_FUSE_INSTR
+#define FUSE_INSTR
+#endif
+
+//!Set by the GDB stub callbacks of mips_gdb_funcs.cpp on the first access
+//!of a debugger, and never cleared: breakpoints may be inserted at any
+//!stop, so the rest of the run executes one instruction per dispatch.
+bool mips_gdb_attached = false;
+
+#ifdef NO_NEED_PC_UPDATE
+#undef FUSE_INSTR
+#endif
+
+#ifdef FUSE_INSTR
+//!Decoded successors of the first instructions of pairs, by pc, so a pair
+//!that does not fuse costs no extra INST_PORT read after its first run. Like
+//!the ArchC decode cache, it assumes code is not modified once loaded.
+#define FUSE_CACHE_SIZE 256   // entries per core, power of two
+
+static struct fuse_entry {
+  uint32_t tag;               // pc | 1, 0 when empty
+  mips_dec_instr d;
+} fuse_cache[MAX_CORES][FUSE_CACHE_SIZE];
+
+//!Copy the cached decoding of the instruction at pc into d.
+static inline bool fuse_lookup(unsigned core, uint32_t pc, mips_dec_instr& d)
+{
+  fuse_entry& e = fuse_cache[core][(pc >> 2) % FUSE_CACHE_SIZE];
+  if (e.tag != (pc | 1))
+    return false;
+  d = e.d;
+  return true;
+}
+
+static inline unsigned fuse_fill(unsigned core, uint32_t pc, uint32_t word, mips_dec_instr& d)
+{
+  fuse_entry& e = fuse_cache[core][(pc >> 2) % FUSE_CACHE_SIZE];
+  e.tag = pc | 1;
+  mips_decode(word, e.d);
+  d = e.d;
+  return d.id;
+}
+
+//!Decode the successor into d. The generic behavior has already set ac_pc
+//!to the address of the next instruction executed, so this is also right
+//!in a delay slot, where ac_pc is the branch target. MIPS_INVALID, so
+//!that nothing fuses, while a debugger is attached.
+#define FUSE_NEXT(d) (mips_gdb_attached ? (unsigned) MIPS_INVALID :      \
+                      fuse_lookup(CORE, ac_pc, d) ? (d).id :            \
+                      fuse_fill(CORE, ac_pc, INST_PORT->read(ac_pc), d))
+
+#ifdef POWER_SIM
+#define FUSE_POWER(d) {                                             \
+    if (CORE < power_stats::instances().size())                     \
+      power_stats::instances()[CORE]->update_stat_power((d).id); }
+#else
+#define FUSE_POWER(d)
+#endif
+
+//!Retire the successor with the same pc update the generic behavior does,
+//!and charge it to the timing model and power_stats, so the fused pair
+//!leaves the state of two separate dispatches.
+#define FUSE_RETIRE(d) {                                            \
+    TIMING_INSTR((d).id, ac_pc);                                    \
+    TRACE_INSTR(ac_instr_counter + 1, ac_pc, (d).word);             \
+    FUSE_POWER(d);                                                  \
+    ac_pc = npc; npc = ac_pc + 4; ac_instr_counter++; fused_pairs++; }
+
+static unsigned long long fused_pairs = 0;
+#endif
+
 //!Generic instruction behavior method.
 void ac_behavior( instruction )
 { 
    dbg_printf("----- PC=%#x ----- %lld\n", (int) ac_pc, ac_instr_counter);
   //  dbg_printf("----- PC=%#x NPC=%#x ----- %lld\n", (int) ac_pc, (int)npc, ac_instr_counter);
+  instr_pc[CORE] = ac_pc;
+  LIVE_STATS_INSTR();
 #ifndef NO_NEED_PC_UPDATE
   ac_pc = npc;
   npc = ac_pc + 4;
 #endif 
 };
  
-//! Instruction Format behavior methods.
-void ac_behavior( Type_R ){}
-void ac_behavior( Type_I ){}
-void ac_behavior( Type_J ){}
+//! Instruction Format behavior methods. They rebuild the instruction word
+//! from its fields for the timing model and the trace, so neither has to
+//! fetch it again.
+void ac_behavior( Type_R )
+{
+  INSTR_ISSUED((op << 26) | (rs << 21) | (rt << 16) | (rd << 11) | (shamt << 6) | func);
+}
+
+void ac_behavior( Type_I )
+{
+  INSTR_ISSUED((op << 26) | (rs << 21) | (rt << 16) | (imm & 0xFFFF));
+}
+
+void ac_behavior( Type_J )
+{
+  INSTR_ISSUED((op << 26) | addr);
+}
  
 //!Behavior called before starting simulation
 void ac_behavior(begin)
@@ -71,12 +398,37 @@ void ac_behavior(begin)
   lo = 0;
 
   RB[29] =  AC_RAM_END - 1024 - processors_started++ * DEFAULT_STACK_SIZE;
+
+#if defined(TIMING_MODEL) && defined(ROI_FAST_FORWARD)
+  timing[CORE].enabled = false;
+#endif
+
+  if (processors_started == 1 && getenv("MIPS_STARTUP_TIME")) {
+    struct timespec now, cpu;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+    fprintf(stderr, "Time to first instruction: %.3lf ms from process start, "
+            "%.3lf ms from static initialization (%.3lf ms CPU)\n",
+            seconds_since_process_start() * 1e3,
+            (now.tv_sec - startup.wall.tv_sec) * 1e3 + (now.tv_nsec - startup.wall.tv_nsec) / 1e6,
+            cpu.tv_sec * 1e3 + cpu.tv_nsec / 1e6);
+  }
 }
 
 //!Behavior called after finishing simulation
 void ac_behavior(end)
 {
   dbg_printf("@@@ end behavior @@@\n");
+#ifdef TIMING_MODEL
+  timing_sync(timing[CORE], CORE, false);
+  timing[CORE].report(stderr, CORE);
+#endif
+  LIVE_STATS_END();
+#ifdef FUSE_INSTR
+  if (ac_instr_counter)
+    fprintf(stderr, "Fused instruction pairs: %llu (%.2f%% fewer dispatches)\n",
+            fused_pairs, 100.0 * fused_pairs / ac_instr_counter);
+#endif
 }
 
 
@@ -85,6 +437,7 @@ void ac_behavior( lb )
 {
   char byte;
   dbg_printf("lb r%d, %d(r%d)\n", rt, imm & 0xFFFF, rs);
+  TIMING_LOAD(RB[rs] + imm);
   byte = DATA_PORT->read_byte(RB[rs]+ imm);
   RB[rt] = (ac_Sword)byte ;
   dbg_printf("Result = %#x\n", RB[rt]);
@@ -95,6 +448,7 @@ void ac_behavior( lbu )
 {
   unsigned char byte;
   dbg_printf("lbu r%d, %d(r%d)\n", rt, imm & 0xFFFF, rs);
+  TIMING_LOAD(RB[rs] + imm);
   byte = DATA_PORT->read_byte(RB[rs]+ imm);
   RB[rt] = byte ;
   dbg_printf("Result = %#x\n", RB[rt]);
@@ -105,6 +459,7 @@ void ac_behavior( lh )
 {
   short int half;
   dbg_printf("lh r%d, %d(r%d)\n", rt, imm & 0xFFFF, rs);
+  TIMING_LOAD(RB[rs] + imm);
   half = DATA_PORT->read_half(RB[rs]+ imm);
   RB[rt] = (ac_Sword)half ;
   dbg_printf("Result = %#x\n", RB[rt]);
@@ -114,6 +469,7 @@ void ac_behavior( lh )
 void ac_behavior( lhu )
 {
   unsigned short int  half;
+  TIMING_LOAD(RB[rs] + imm);
   half = DATA_PORT->read_half(RB[rs]+ imm);
   RB[rt] = half ;
   dbg_printf("Result = %#x\n", RB[rt]);
@@ -123,6 +479,7 @@ void ac_behavior( lhu )
 void ac_behavior( lw )
 {
   dbg_printf("lw r%d, %d(r%d)\n", rt, imm & 0xFFFF, rs);
+  TIMING_LOAD(RB[rs] + imm);
   RB[rt] = DATA_PORT->read(RB[rs]+ imm);
   dbg_printf("Result = %#x\n", RB[rt]);
 };
@@ -136,6 +493,28 @@ void ac_behavior( lwl )
 
   addr = RB[rs] + imm;
   offset = (addr & 0x3) * 8;
+  TIMING_LOAD(addr);
+
+#ifdef FUSE_INSTR
+  // lwl rt, off(rs); lwr rt, off+3(rs): unaligned word load
+  mips_dec_instr next;
+  if (FUSE_NEXT(next) == MIPS_LWR && next.rt == rt && next.rs == rs &&
+      rs != rt && next.imm == imm + 3) {
+    TIMING_LOAD(addr + 3);    // the load of lwr, even when it hits the same word
+    if (offset == 0)
+      data = DATA_PORT->read(addr);
+    else {
+      data = ((ac_Uword) DATA_PORT->read(addr & 0xFFFFFFFC) << offset) |
+             ((ac_Uword) DATA_PORT->read((addr + 3) & 0xFFFFFFFC) >> (32 - offset));
+    }
+    RB[rt] = data;
+    FUSE_RETIRE(next);
+    dbg_printf("Fused lwr r%d, %d(r%d)\n", rt, (imm + 3) & 0xFFFF, rs);
+    dbg_printf("Result = %#x\n", RB[rt]);
+    return;
+  }
+#endif
+
   data = DATA_PORT->read(addr & 0xFFFFFFFC);
   data <<= offset;
   data |= RB[rt] & ((1<<offset)-1);
@@ -152,6 +531,7 @@ void ac_behavior( lwr )
 
   addr = RB[rs] + imm;
   offset = (3 - (addr & 0x3)) * 8;
+  TIMING_LOAD(addr);
   data = DATA_PORT->read(addr & 0xFFFFFFFC);
   data >>= offset;
   data |= RB[rt] & (0xFFFFFFFF << (32-offset));
@@ -165,7 +545,9 @@ void ac_behavior( sb )
   unsigned char byte;
   dbg_printf("sb r%d, %d(r%d)\n", rt, imm & 0xFFFF, rs);
   byte = RB[rt] & 0xFF;
+  TIMING_STORE(RB[rs] + imm);
   DATA_PORT->write_byte(RB[rs] + imm, byte);
+  LLSC_STORE(RB[rs] + imm);
   dbg_printf("Result = %#x\n", (int) byte);
 };
 
@@ -175,7 +557,9 @@ void ac_behavior( sh )
   unsigned short int half;
   dbg_printf("sh r%d, %d(r%d)\n", rt, imm & 0xFFFF, rs);
   half = RB[rt] & 0xFFFF;
+  TIMING_STORE(RB[rs] + imm);
   DATA_PORT->write_half(RB[rs] + imm, half);
+  LLSC_STORE(RB[rs] + imm);
   dbg_printf("Result = %#x\n", (int) half);
 };
 
@@ -183,7 +567,9 @@ void ac_behavior( sh )
 void ac_behavior( sw )
 {
   dbg_printf("sw r%d, %d(r%d)\n", rt, imm & 0xFFFF, rs);
+  TIMING_STORE(RB[rs] + imm);
   DATA_PORT->write(RB[rs] + imm, RB[rt]);
+  LLSC_STORE(RB[rs] + imm);
   dbg_printf("Result = %#x\n", RB[rt]);
 };
 
@@ -196,10 +582,39 @@ void ac_behavior( swl )
 
   addr = RB[rs] + imm;
   offset = (addr & 0x3) * 8;
+  TIMING_STORE(addr);
+
+#ifdef FUSE_INSTR
+  // swl rt, off(rs); swr rt, off+3(rs): unaligned word store
+  mips_dec_instr next;
+  if (FUSE_NEXT(next) == MIPS_SWR && next.rt == rt && next.rs == rs &&
+      next.imm == imm + 3) {
+    data = RB[rt];
+    TIMING_STORE(addr + 3);   // the store of swr, even when it hits the same word
+    if (offset == 0)
+      DATA_PORT->write(addr, data);
+    else {
+      unsigned int addr_hi = (addr + 3) & 0xFFFFFFFC;
+      addr &= 0xFFFFFFFC;
+      DATA_PORT->write(addr, (data >> offset) |
+                       (DATA_PORT->read(addr) & (0xFFFFFFFF << (32 - offset))));
+      DATA_PORT->write(addr_hi, (data << (32 - offset)) |
+                       (DATA_PORT->read(addr_hi) & ((1 << (32 - offset)) - 1)));
+      LLSC_STORE(addr_hi);
+    }
+    LLSC_STORE(addr);
+    FUSE_RETIRE(next);
+    dbg_printf("Fused swr r%d, %d(r%d)\n", rt, (imm + 3) & 0xFFFF, rs);
+    dbg_printf("Result = %#x\n", data);
+    return;
+  }
+#endif
+
   data = RB[rt];
   data >>= offset;
   data |= DATA_PORT->read(addr & 0xFFFFFFFC) & (0xFFFFFFFF << (32-offset));
   DATA_PORT->write(addr & 0xFFFFFFFC, data);
+  LLSC_STORE(addr);
   dbg_printf("Result = %#x\n", data);
 };
 
@@ -212,10 +627,12 @@ void ac_behavior( swr )
 
   addr = RB[rs] + imm;
   offset = (3 - (addr & 0x3)) * 8;
+  TIMING_STORE(addr);
   data = RB[rt];
   data <<= offset;
   data |= DATA_PORT->read(addr & 0xFFFFFFFC) & ((1<<offset)-1);
   DATA_PORT->write(addr & 0xFFFFFFFC, data);
+  LLSC_STORE(addr);
   dbg_printf("Result = %#x\n", data);
 };
 
@@ -299,6 +716,22 @@ void ac_behavior( lui )
   // and moved to the target register ( rt )
   RB[rt] = imm << 16;
   dbg_printf("Result = %#x\n", RB[rt]);
+
+#ifdef FUSE_INSTR
+  // lui rt, hi; ori/addiu rt, rt, lo: 32-bit constant or address
+  mips_dec_instr next;
+  unsigned next_id = FUSE_NEXT(next);
+  if ((next_id == MIPS_ORI || next_id == MIPS_ADDIU) && next.rs == rt) {
+    if (next.id == MIPS_ORI)
+      RB[next.rt] = RB[rt] | (next.imm & 0xFFFF);
+    else
+      RB[next.rt] = RB[rt] + next.imm;
+    FUSE_RETIRE(next);
+    dbg_printf("Fused %s r%d, r%d, %d\n", next.id == MIPS_ORI ? "ori" : "addiu",
+               next.rt, rt, next.imm & 0xFFFF);
+    dbg_printf("Result = %#x\n", RB[next.rt]);
+  }
+#endif
 };
 
 //!Instruction add behavior method.
@@ -352,6 +785,23 @@ void ac_behavior( slt )
   else
     RB[rd] = 0;
   dbg_printf("Result = %#x\n", RB[rd]);
+
+#ifdef FUSE_INSTR
+  // slt rd, rs, rt; beq/bne rd, $0, target: compare and branch
+  mips_dec_instr next;
+  unsigned next_id = FUSE_NEXT(next);
+  if ((next_id == MIPS_BEQ || next_id == MIPS_BNE) &&
+      (next.rs == rd || next.rt == rd)) {
+    bool taken = (RB[next.rs] == RB[next.rt]) == (next.id == MIPS_BEQ);
+    FUSE_RETIRE(next);
+    dbg_printf("Fused %s r%d, r%d, %d\n", next.id == MIPS_BEQ ? "beq" : "bne",
+               next.rt, next.rs, next.imm & 0xFFFF);
+    if (taken) {
+      npc = ac_pc + (next.imm << 2);
+      dbg_printf("Taken to %#x\n", ac_pc + (next.imm << 2));
+    }
+  }
+#endif
 };
 
 //!Instruction sltu behavior method.
@@ -365,6 +815,23 @@ void ac_behavior( sltu )
   else
     RB[rd] = 0;
   dbg_printf("Result = %#x\n", RB[rd]);
+
+#ifdef FUSE_INSTR
+  // sltu rd, rs, rt; beq/bne rd, $0, target: compare and branch
+  mips_dec_instr next;
+  unsigned next_id = FUSE_NEXT(next);
+  if ((next_id == MIPS_BEQ || next_id == MIPS_BNE) &&
+      (next.rs == rd || next.rt == rd)) {
+    bool taken = (RB[next.rs] == RB[next.rt]) == (next.id == MIPS_BEQ);
+    FUSE_RETIRE(next);
+    dbg_printf("Fused %s r%d, r%d, %d\n", next.id == MIPS_BEQ ? "beq" : "bne",
+               next.rt, next.rs, next.imm & 0xFFFF);
+    if (taken) {
+      npc = ac_pc + (next.imm << 2);
+      dbg_printf("Taken to %#x\n", ac_pc + (next.imm << 2));
+    }
+  }
+#endif
 };
 
 //!Instruction instr_and behavior method.
@@ -473,6 +940,17 @@ void ac_behavior( mult )
   hi = half_result ;
 
   dbg_printf("Result = %#llx\n", result);
+
+#ifdef FUSE_INSTR
+  // mult rs, rt; mflo rd: 32-bit product
+  mips_dec_instr next;
+  if (FUSE_NEXT(next) == MIPS_MFLO) {
+    RB[next.rd] = lo;
+    FUSE_RETIRE(next);
+    dbg_printf("Fused mflo r%d\n", next.rd);
+    dbg_printf("Result = %#x\n", RB[next.rd]);
+  }
+#endif
 };
 
 //!Instruction multu behavior method.
@@ -495,6 +973,17 @@ void ac_behavior( multu )
   hi = half_result ;
 
   dbg_printf("Result = %#llx\n", result);
+
+#ifdef FUSE_INSTR
+  // multu rs, rt; mflo rd: 32-bit product
+  mips_dec_instr next;
+  if (FUSE_NEXT(next) == MIPS_MFLO) {
+    RB[next.rd] = lo;
+    FUSE_RETIRE(next);
+    dbg_printf("Fused mflo r%d\n", next.rd);
+    dbg_printf("Result = %#x\n", RB[next.rd]);
+  }
+#endif
 };
 
 //!Instruction div behavior method.
@@ -718,6 +1207,106 @@ void ac_behavior( sys_call )
 //!Instruction instr_break behavior method.
 void ac_behavior( instr_break )
 {
-  fprintf(stderr, "instr_break behavior not implemented.\n"); 
-  exit(EXIT_FAILURE);
+  unsigned int code = (rs << 5) | rt;
+  roi_snapshot& r = roi[CORE];
+
+  dbg_printf("break %d\n", code);
+
+  if (code == ROI_BEGIN_CODE && !r.active) {
+#ifdef TIMING_MODEL
+    timing_sync(timing[CORE], CORE, true);
+    timing[CORE].reset_counters();
+    timing[CORE].enabled = true;
+#endif
+    r.active = true;
+    r.instrs = ac_instr_counter;
+    r.time = sc_core::sc_time_stamp().to_seconds();
+    r.energy = 0;
+#ifdef POWER_SIM
+    if (CORE < power_stats::instances().size())
+      r.energy = power_stats::instances()[CORE]->get_total_energy();
+#endif
+    fprintf(stderr, "ROI (core %d): begin at instruction %llu\n", (int) CORE, r.instrs);
+  }
+  else if (code == ROI_END_CODE && r.active) {
+#ifdef TIMING_MODEL
+    timing_sync(timing[CORE], CORE, true);
+    timing[CORE].report(stderr, CORE);
+#ifdef ROI_FAST_FORWARD
+    timing[CORE].enabled = false;
+#endif
+#endif
+    r.active = false;
+    fprintf(stderr, "ROI (core %d): %llu instructions, %.9lf s simulated time\n",
+            (int) CORE, ac_instr_counter - r.instrs,
+            sc_core::sc_time_stamp().to_seconds() - r.time);
+#ifdef POWER_SIM
+    if (CORE < power_stats::instances().size())
+      fprintf(stderr, "ROI (core %d): %lf energy\n", (int) CORE,
+              power_stats::instances()[CORE]->get_total_energy() - r.energy);
+#endif
+  }
+  else if (code != ROI_BEGIN_CODE && code != ROI_END_CODE) {
+    fprintf(stderr, "instr_break behavior not implemented.\n"); 
+    exit(EXIT_FAILURE);
+  }
+}
+
+//!Instruction ll behavior method.
+void ac_behavior( ll )
+{
+  dbg_printf("ll r%d, %d(r%d)\n", rt, imm & 0xFFFF, rs);
+  uint32_t addr = RB[rs] + imm;
+  unsigned cores = llsc_cores.load(std::memory_order_relaxed);
+
+  // Publish the reservation before the load, so that any store that may
+  // land after the load breaks it
+  while (cores <= CORE && !llsc_cores.compare_exchange_weak(cores, CORE + 1))
+    ;
+  if (cores == 0)
+    llsc_first_use();
+  if (reservation[CORE].exchange(LLSC_TAG(addr)) == 0)
+    reservations_held++;
+
+  TIMING_LOAD(addr);
+  RB[rt] = DATA_PORT->read(addr);
+  dbg_printf("Result = %#x\n", RB[rt]);
+}
+
+//!Instruction sc behavior method.
+void ac_behavior( sc )
+{
+  dbg_printf("sc r%d, %d(r%d)\n", rt, imm & 0xFFFF, rs);
+  uint32_t addr = RB[rs] + imm;
+  bool success;
+
+  // Check, write and break as one step against other cores' sc. The write
+  // may wait() in a TLM port for simulated time, so a core finding the
+  // lock taken sleeps until the holder releases it: a delta cycle wait
+  // would keep simulated time from advancing to that release.
+  while (llsc_lock.test_and_set(std::memory_order_acquire))
+    sc_core::wait(llsc_unlocked());
+
+  success = (reservation[CORE].load() == LLSC_TAG(addr));
+  if (success) {
+    TIMING_STORE(addr);
+    DATA_PORT->write(addr, RB[rt]);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    llsc_break(CORE, addr);
+  }
+  llsc_lock.clear(std::memory_order_release);
+  llsc_unlocked().notify(sc_core::SC_ZERO_TIME);
+
+  if (reservation[CORE].exchange(0))
+    reservations_held--;
+
+  RB[rt] = success;
+  dbg_printf("Result = %d\n", (int) success);
+}
+
+//!Instruction instr_sync behavior method.
+void ac_behavior( instr_sync )
+{
+  dbg_printf("sync\n");
+  std::atomic_thread_fence(std::memory_order_seq_cst);
 }
@@ -0,0 +1,156 @@
+/**
+ * @file      mips_stats_watch.cpp
+ *
+ *            The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @brief     Watch the live statistics of a running MIPS simulator.
+ *
+ * Maps the shared memory object named by MIPS_LIVE_STATS in the simulator
+ * (see mips_live_stats.H) read-only and prints one line per core every
+ * interval. A running core that has not published for STALL_GAPS times
+ * its last publication interval (and at least STALL_MIN_SECONDS) is
+ * flagged as stalled; one that keeps running at the same pc is likely in
+ * a spin loop.
+ *
+ * Build:  g++ -O2 -o mips-stats-watch mips_stats_watch.cpp -lrt
+ * Usage:  mips-stats-watch [-i seconds] [-s] [-1] <name>
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#include "mips_live_stats.H"
+
+#define STALL_GAPS        4
+#define STALL_MIN_SECONDS 2.0
+
+static const char* state_name[] = { "idle", "running", "finished" };
+
+static void usage(const char* prog)
+{
+  fprintf(stderr, "Usage: %s [-i seconds] [-s] [-1] <name>\n"
+          "  -i seconds   refresh interval (default 1)\n"
+          "  -s           also list syscall counts per stub address\n"
+          "  -1           print once and exit\n", prog);
+  exit(EXIT_FAILURE);
+}
+
+static void print_rate(double rate)
+{
+  if (rate < 0)
+    printf(" %7s", "-");
+  else
+    printf(" %6.2f%%", 100.0 * rate);
+}
+
+int main(int argc, char** argv)
+{
+  double interval = 1.0;
+  bool syscalls = false, once = false;
+  const char* name = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-i") && i + 1 < argc)
+      interval = atof(argv[++i]);
+    else if (!strcmp(argv[i], "-s"))
+      syscalls = true;
+    else if (!strcmp(argv[i], "-1"))
+      once = true;
+    else if (argv[i][0] != '-' && !name)
+      name = argv[i];
+    else
+      usage(argv[0]);
+  }
+  if (!name || interval <= 0)
+    usage(argv[0]);
+
+  char path[256];
+  snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name);
+
+  int fd = shm_open(path, O_RDONLY, 0);
+  if (fd < 0) {
+    perror(path);
+    return EXIT_FAILURE;
+  }
+  void* p = mmap(NULL, sizeof(live_stats_segment), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    perror("mmap");
+    return EXIT_FAILURE;
+  }
+
+  const live_stats_segment* seg = (const live_stats_segment*) p;
+  if (__atomic_load_n(&seg->magic, __ATOMIC_ACQUIRE) != LIVE_STATS_MAGIC ||
+      seg->version != LIVE_STATS_VERSION) {
+    fprintf(stderr, "%s: not a live statistics segment of this version\n", path);
+    return EXIT_FAILURE;
+  }
+
+  unsigned long long prev_instrs[LIVE_STATS_CORES];
+  uint32_t prev_pc[LIVE_STATS_CORES];
+  memset(prev_instrs, 0, sizeof(prev_instrs));
+  memset(prev_pc, 0, sizeof(prev_pc));
+
+  struct timespec pause;
+  pause.tv_sec = (time_t) interval;
+  pause.tv_nsec = (long) ((interval - pause.tv_sec) * 1e9);
+
+  for (;;) {
+    bool running = false;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    printf("pid %d\n%4s %9s %16s %8s %10s %9s %8s %8s %8s %12s %12s\n",
+           seg->pid, "core", "state", "instructions", "MIPS", "pc", "syscalls",
+           "I$ hit", "D$ hit", "profile", "window [J]", "total [J]");
+
+    for (unsigned c = 0; c < seg->num_cores && c < LIVE_STATS_CORES; c++) {
+      live_stats_core s;
+      live_stats_read(seg, c, &s);
+      if (s.state == LIVE_STATS_IDLE)
+        continue;
+
+      printf("%4u %9s %16llu %8.2f %#10x %9llu", c, state_name[s.state % 3],
+             (unsigned long long) s.instrs, s.ips / 1e6, s.pc,
+             (unsigned long long) s.syscalls);
+      print_rate(s.icache_hit_rate);
+      print_rate(s.dcache_hit_rate);
+      if (s.power_profile < 0)
+        printf(" %8s %12s %12s", "-", "-", "-");
+      else
+        printf(" %8d %12.6g %12.6g", s.power_profile, s.window_energy, s.total_energy);
+
+      if (s.state == LIVE_STATS_RUNNING) {
+        running = true;
+        double silent = now.tv_sec + now.tv_nsec / 1e9 - s.updated;
+        if (silent > STALL_GAPS * s.gap && silent > STALL_MIN_SECONDS)
+          printf("  stalled");
+        else if (s.instrs != prev_instrs[c] && s.pc == prev_pc[c])
+          printf("  same pc");
+      }
+      printf("\n");
+
+      if (syscalls)
+        for (unsigned k = 0; k < LIVE_STATS_SYSCALL_SLOTS && s.syscall_count[k]; k++)
+          printf("       syscall stub %#10x: %llu\n", s.syscall_pc[k],
+                 (unsigned long long) s.syscall_count[k]);
+
+      prev_instrs[c] = s.instrs;
+      prev_pc[c] = s.pc;
+    }
+    printf("\n");
+    fflush(stdout);
+
+    if (once || (!running && seg->num_cores))
+      break;
+    nanosleep(&pause, NULL);
+  }
+
+  munmap(p, sizeof(live_stats_segment));
+  return EXIT_SUCCESS;
+}
@@ -34,54 +34,321 @@
  */
 
 #include "mips_syscall.H"
+#include <vector>
+
+#ifdef LIVE_STATS
+#include "mips_live_stats.H"
+#endif
 
 // 'using namespace' statement to allow access to all
 // mips-specific datatypes
 using namespace mips_parms;
 unsigned procNumber = 0;
 
-void mips_syscall::get_buffer(int argn, unsigned char* buf, unsigned int size)
+//! Syscall record/replay. With MIPS_SYSCALL_RECORD=<file>, every call the
+//! ac_syscall layer makes into this interface is logged in order:
+//! - argument words read (get_int) and a hash of buffers read (get_buffer)
+//! - buffers and words written back to the guest (set_buffer, set_int)
+//! - the stub the syscall returns from
+//! - the program arguments, as a count and a hash
+//! With MIPS_SYSCALL_REPLAY=<file>, the writes back to the guest take
+//! their values from the log, and the reads are checked against it to
+//! catch a guest that diverged from the recorded run. The host I/O
+//! syscalls declared in mips_syscall.H skip the host entirely and only
+//! apply their logged effects; a syscall not declared there stops the
+//! replay before it can reach the host.
+enum syscall_event_type {
+  SYSL_GET_INT             = 'i',
+  SYSL_GET_BUFFER          = 'g',
+  SYSL_SET_BUFFER          = 'b',
+  SYSL_SET_BUFFER_NOINVERT = 'n',
+  SYSL_SET_INT             = 's',
+  SYSL_RETURN              = 'r',
+  SYSL_PROG_ARGS           = 'a'
+};
+
+struct syscall_event {
+  unsigned char type, argn;
+  unsigned int value;                 // word, buffer size or stub address
+  unsigned int aux;                   // hash of a buffer read
+  std::vector<unsigned char> data;    // buffer written
+};
+
+class syscall_log {
+  FILE* file;
+  unsigned long long syscalls;
+  bool have_next;
+  syscall_event next;
+
+  static const unsigned HEADER_SIZE = 10;
+
+  const syscall_event& peek()
+  {
+    if (!have_next) {
+      unsigned char h[HEADER_SIZE];
+      if (fread(h, 1, HEADER_SIZE, file) != HEADER_SIZE)
+        fail("log exhausted");
+      next.type  = h[0];
+      next.argn  = h[1];
+      next.value = h[2] | (h[3] << 8) | (h[4] << 16) | ((unsigned) h[5] << 24);
+      next.aux   = h[6] | (h[7] << 8) | (h[8] << 16) | ((unsigned) h[9] << 24);
+      next.data.clear();
+      if (next.type == SYSL_SET_BUFFER || next.type == SYSL_SET_BUFFER_NOINVERT) {
+        next.data.resize(next.value);
+        if (next.value && fread(&next.data[0], 1, next.value, file) != next.value)
+          fail("truncated log");
+      }
+      have_next = true;
+    }
+    return next;
+  }
+
+public:
+  bool recording, replaying;
+
+  void fail(const char* what)
+  {
+    fprintf(stderr, "Syscall replay: %s at syscall %llu\n", what, syscalls);
+    exit(EXIT_FAILURE);
+  }
+
+  syscall_log() : file(NULL), syscalls(0), have_next(false), recording(false), replaying(false)
+  {
+    const char* rec = getenv("MIPS_SYSCALL_RECORD");
+    const char* rep = getenv("MIPS_SYSCALL_REPLAY");
+
+    if (rec && rep) {
+      fprintf(stderr, "MIPS_SYSCALL_RECORD and MIPS_SYSCALL_REPLAY are exclusive\n");
+      exit(EXIT_FAILURE);
+    }
+    if (rec || rep) {
+      file = fopen(rec ? rec : rep, rec ? "wb" : "rb");
+      if (file == NULL) {
+        perror(rec ? rec : rep);
+        exit(EXIT_FAILURE);
+      }
+      recording = (rec != NULL);
+      replaying = (rep != NULL);
+    }
+  }
+
+  ~syscall_log()
+  {
+    if (file)
+      fclose(file);
+  }
+
+  static unsigned int hash(const unsigned char* buf, unsigned int size)
+  {
+    unsigned int h = 2166136261u;     // FNV-1a
+    for (unsigned int i = 0; i < size; i++)
+      h = (h ^ buf[i]) * 16777619u;
+    return h;
+  }
+
+  void put(syscall_event_type type, int argn, unsigned int value, unsigned int aux = 0,
+           const unsigned char* data = NULL)
+  {
+    unsigned char h[HEADER_SIZE] = {
+      (unsigned char) type, (unsigned char) argn,
+      (unsigned char) value, (unsigned char) (value >> 8),
+      (unsigned char) (value >> 16), (unsigned char) (value >> 24),
+      (unsigned char) aux, (unsigned char) (aux >> 8),
+      (unsigned char) (aux >> 16), (unsigned char) (aux >> 24)
+    };
+    fwrite(h, 1, HEADER_SIZE, file);
+    if (data && value)
+      fwrite(data, 1, value, file);
+    if (type == SYSL_RETURN)
+      syscalls++;
+  }
+
+  //! Consume the next event, which must be of this type and argument.
+  syscall_event& take(syscall_event_type type, int argn)
+  {
+    peek();
+    if (next.type != type || next.argn != argn)
+      fail("guest diverged from the log");
+    have_next = false;
+    if (type == SYSL_RETURN)
+      syscalls++;
+    return next;
+  }
+
+  //! Type and argument of the next event, without consuming it.
+  syscall_event_type upcoming()
+  {
+    return (syscall_event_type) peek().type;
+  }
+
+  int upcoming_argn()
+  {
+    return peek().argn;
+  }
+
+  //! Word, buffer size or stub address of the next event.
+  unsigned int upcoming_value()
+  {
+    return peek().value;
+  }
+
+  void check(syscall_event_type type, int argn, unsigned int value, unsigned int aux = 0,
+             const char* what = "guest diverged from the log")
+  {
+    syscall_event& e = take(type, argn);
+    if (e.value != value || e.aux != aux)
+      fail(what);
+  }
+};
+
+static syscall_log sys_log;
+
+//! Guest memory is big-endian. Its storage byte order is owned by ArchC's
+//! ac_mem/ac_memport (and the TLM memory of the platforms), not by this
+//! model, so words are still swapped on every port access. Here only the
+//! syscall boundary is batched: the aligned body of a buffer is moved one
+//! word per port access and split/assembled in guest byte order, instead
+//! of issuing one byte access per character.
+static inline void unpack_word(unsigned char* buf, ac_word w)
 {
-  unsigned int addr = RB[4+argn];
+  buf[0] = w >> 24;
+  buf[1] = w >> 16;
+  buf[2] = w >> 8;
+  buf[3] = w;
+}
 
-  for (unsigned int i = 0; i<size; i++, addr++) {
-    buf[i] = DATA_PORT->read_byte(addr);
+static inline ac_word pack_word(const unsigned char* buf)
+{
+  return ((ac_word) buf[0] << 24) | ((ac_word) buf[1] << 16) |
+         ((ac_word) buf[2] << 8)  |  (ac_word) buf[3];
+}
+
+void mips_syscall::check_replay_safe()
+{
+  if (!replay_safe) {
+    fprintf(stderr, "Syscall replay: the syscall at %#x is not replayed and would reach the "
+            "host; declare it in mips_syscall.H\n", (unsigned) ac_pc);
+    exit(EXIT_FAILURE);
   }
 }
 
-void mips_syscall::set_buffer(int argn, unsigned char* buf, unsigned int size)
+void mips_syscall::copy_to_guest(unsigned int addr, const unsigned char* buf, unsigned int size)
 {
-  unsigned int addr = RB[4+argn];
+  unsigned int i = 0;
 
-  for (unsigned int i = 0; i<size; i++, addr++) {
+  for (; i<size && (addr & 3); i++, addr++)
     DATA_PORT->write_byte(addr, buf[i]);
-    //printf("\nDATA_PORT[%d]=%d", addr, buf[i]);
 
+  for (; i+4 <= size; i+=4, addr+=4)
+    DATA_PORT->write(addr, pack_word(&buf[i]));
+
+  for (; i<size; i++, addr++)
+    DATA_PORT->write_byte(addr, buf[i]);
+}
+
+void mips_syscall::get_buffer(int argn, unsigned char* buf, unsigned int size)
+{
+  unsigned int addr = RB[4+argn];
+  unsigned int i = 0;
+
+  if (sys_log.replaying)
+    check_replay_safe();
+
+  for (; i<size && (addr & 3); i++, addr++)
+    buf[i] = DATA_PORT->read_byte(addr);
+
+  for (; i+4 <= size; i+=4, addr+=4)
+    unpack_word(&buf[i], DATA_PORT->read(addr));
+
+  for (; i<size; i++, addr++)
+    buf[i] = DATA_PORT->read_byte(addr);
+
+  if (sys_log.recording)
+    sys_log.put(SYSL_GET_BUFFER, argn, size, syscall_log::hash(buf, size));
+  else if (sys_log.replaying)
+    sys_log.check(SYSL_GET_BUFFER, argn, size, syscall_log::hash(buf, size));
+}
+
+void mips_syscall::set_buffer(int argn, unsigned char* buf, unsigned int size)
+{
+  if (sys_log.recording)
+    sys_log.put(SYSL_SET_BUFFER, argn, size, 0, buf);
+  else if (sys_log.replaying) {
+    check_replay_safe();
+    syscall_event& e = sys_log.take(SYSL_SET_BUFFER, argn);
+    buf = e.data.empty() ? NULL : &e.data[0];
+    size = e.data.size();
   }
+
+  copy_to_guest(RB[4+argn], buf, size);
 }
 
+//! Copies host words (not bytes) to the guest: each word keeps its numeric
+//! value and the data port stores it in guest order. Kept for the ac_syscall
+//! interface; the model itself converts at the byte boundary above.
 void mips_syscall::set_buffer_noinvert(int argn, unsigned char* buf, unsigned int size)
 {
   unsigned int addr = RB[4+argn];
+  unsigned int i = 0;
 
-  for (unsigned int i = 0; i<size; i+=4, addr+=4) {
-    DATA_PORT->write(addr, *(unsigned int *) &buf[i]);
-    //printf("\nDATA_PORT_no[%d]=%d", addr, buf[i]);
+  if (sys_log.recording)
+    sys_log.put(SYSL_SET_BUFFER_NOINVERT, argn, size, 0, buf);
+  else if (sys_log.replaying) {
+    check_replay_safe();
+    syscall_event& e = sys_log.take(SYSL_SET_BUFFER_NOINVERT, argn);
+    buf = e.data.empty() ? NULL : &e.data[0];
+    size = e.data.size();
   }
+
+  for (; i+4 <= size; i+=4, addr+=4)
+    DATA_PORT->write(addr, *(unsigned int *) &buf[i]);
+
+  for (; i<size; i++, addr++)
+    DATA_PORT->write_byte(addr, buf[i]);
 }
 
 int mips_syscall::get_int(int argn)
 {
+  if (sys_log.recording)
+    sys_log.put(SYSL_GET_INT, argn, RB[4+argn]);
+  else if (sys_log.replaying) {
+    check_replay_safe();
+    sys_log.check(SYSL_GET_INT, argn, RB[4+argn]);
+  }
+
   return RB[4+argn];
 }
 
 void mips_syscall::set_int(int argn, int val)
 {
+  if (sys_log.recording)
+    sys_log.put(SYSL_SET_INT, argn, val);
+  else if (sys_log.replaying) {
+    check_replay_safe();
+    val = sys_log.take(SYSL_SET_INT, argn).value;
+  }
+
   RB[2+argn] = val;
 }
 
 void mips_syscall::return_from_syscall()
 {
+  if (sys_log.recording)
+    sys_log.put(SYSL_RETURN, 0, ac_pc);
+  else if (sys_log.replaying) {
+    check_replay_safe();
+    replay_safe = false;
+    if (sys_log.take(SYSL_RETURN, 0).value != ac_pc) {
+      fprintf(stderr, "Syscall replay: guest diverged from the log (returning from %#x)\n",
+              (unsigned) ac_pc);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+#ifdef LIVE_STATS
+  // ac_pc is still the entry point of the emulated stub
+  live_stats().syscall(id.read() % LIVE_STATS_CORES, ac_pc);
+#endif
   ac_pc = RB[31];
   npc = ac_pc + 4;
 }
@@ -92,23 +359,27 @@ void mips_syscall::set_prog_args(int argc, char **argv)
 
   int i, j, base;
 
-  unsigned int ac_argv[30];
-  char ac_argstr[512];
+  unsigned char ac_argv[120] = { 0 };
+  char ac_argstr[512] = { 0 };
 
   base = AC_RAM_END - 512 - procNumber * 64 * 1024;
   for (i=0, j=0; i<argc; i++) {
     int len = strlen(argv[i]) + 1;
-    ac_argv[i] = base + j;
+    unpack_word(&ac_argv[i*4], base + j);
     memcpy(&ac_argstr[j], argv[i], len);
     j += len;
   }
 
-  RB[4] = base;
-  set_buffer(0, (unsigned char*) ac_argstr, 512);   //$25 = $29(sp) - 4 (set_buffer adds 4)
-  
+  // The arguments are inputs of the run, not syscall results: they are
+  // not replayed from the log, but a replay with others is refused
+  if (sys_log.recording)
+    sys_log.put(SYSL_PROG_ARGS, 0, argc, syscall_log::hash((unsigned char*) ac_argstr, j));
+  else if (sys_log.replaying)
+    sys_log.check(SYSL_PROG_ARGS, 0, argc, syscall_log::hash((unsigned char*) ac_argstr, j),
+                  "program arguments differ from the recorded run");
 
-  RB[4] = base - 120;
-  set_buffer_noinvert(0, (unsigned char*) ac_argv, 120);
+  copy_to_guest(base, (unsigned char*) ac_argstr, 512);
+  copy_to_guest(base - 120, ac_argv, 120);
 
   //RB[4] = AC_RAM_END-512-128;
 
@@ -122,4 +393,71 @@ void mips_syscall::set_prog_args(int argc, char **argv)
 }
 
 
+//! Apply the logged effects of one syscall without running it. Reads are
+//! repeated so that get_int and get_buffer check the guest arguments
+//! against the log, writes to the guest are taken from the log by the
+//! interface functions themselves.
+void mips_syscall::replay_syscall()
+{
+  std::vector<unsigned char> buf;
+
+  replay_safe = true;
+
+  for (;;) {
+    switch (sys_log.upcoming()) {
+    case SYSL_GET_INT:
+      get_int(sys_log.upcoming_argn());
+      break;
+    case SYSL_GET_BUFFER:
+      buf.resize(sys_log.upcoming_value());
+      get_buffer(sys_log.upcoming_argn(), buf.empty() ? NULL : &buf[0], buf.size());
+      break;
+    case SYSL_SET_BUFFER:
+      set_buffer(sys_log.upcoming_argn(), NULL, 0);
+      break;
+    case SYSL_SET_BUFFER_NOINVERT:
+      set_buffer_noinvert(sys_log.upcoming_argn(), NULL, 0);
+      break;
+    case SYSL_SET_INT:
+      set_int(sys_log.upcoming_argn(), 0);
+      break;
+    case SYSL_RETURN:
+      return_from_syscall();
+      return;
+    default:
+      fprintf(stderr, "Syscall replay: corrupt log\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+#define REPLAYED_SYSCALL(name)                          \
+  void mips_syscall::name()                             \
+  {                                                     \
+    if (sys_log.replaying)                              \
+      replay_syscall();                                 \
+    else                                                \
+      ac_syscall<ac_word, ac_Hword>::name();            \
+  }
+
+REPLAYED_SYSCALL(open)
+REPLAYED_SYSCALL(creat)
+REPLAYED_SYSCALL(close)
+REPLAYED_SYSCALL(read)
+REPLAYED_SYSCALL(write)
+REPLAYED_SYSCALL(isatty)
+REPLAYED_SYSCALL(lseek)
+REPLAYED_SYSCALL(fstat)
+REPLAYED_SYSCALL(times)
+REPLAYED_SYSCALL(time)
+REPLAYED_SYSCALL(random)
+
+#define GUEST_ONLY_SYSCALL(name)                        \
+  void mips_syscall::name()                             \
+  {                                                     \
+    replay_safe = true;                                 \
+    ac_syscall<ac_word, ac_Hword>::name();              \
+  }
 
+GUEST_ONLY_SYSCALL(sbrk)
+GUEST_ONLY_SYSCALL(_exit)
@@ -0,0 +1,253 @@
+/**
+ * @file      decoder_check.cpp
+ *
+ *            The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @brief     Check mips_decoder.H against the decoder of mips_isa.ac.
+ *
+ * Reads the ac_format, ac_instr, set_decoder() and set_cycles() lines of
+ * mips_isa.ac. The set_cycles() latency of every instruction must equal
+ * its mips_latency[] entry in mips_timing.H (with the default MULT_LATENCY
+ * and DIV_LATENCY). Words are decoded the way ArchC does: the first
+ * instruction, in declaration order, whose field constraints all hold.
+ * Every combination of the bits some set_decoder() line constrains is
+ * enumerated, with the other bits random, and compared with
+ * mips_decode_id(). Ids are the declaration order, the numbering of the
+ * mips_instr_id enum.
+ *
+ * Then both decoders are timed over a sample of the words checked, and the
+ * nanoseconds per word of each are printed. The reference is a first-match
+ * scan like the one mips_decoder.H replaced, so the ratio is the speedup
+ * of the table (an estimate: the reference scans a vector, not ArchC code).
+ *
+ * Usage:  decoder_check [mips_isa.ac]
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "mips_decoder.H"
+#include "mips_timing.H"
+
+struct field {
+  unsigned shift, width;
+};
+
+struct instr {
+  std::string name, format;
+  unsigned id;
+  bool decoded;
+  uint32_t mask, value;
+  int cycles;                 // set_cycles() latency, -1 when not given
+};
+
+static std::map<std::string, std::map<std::string, field> > formats;
+static std::vector<instr> instrs;
+
+static void fail(const char* msg, const std::string& what)
+{
+  fprintf(stderr, "decoder_check: %s %s\n", msg, what.c_str());
+  exit(EXIT_FAILURE);
+}
+
+//! "%op:6 %rs:5 %imm:16:s" -> field positions, most significant first.
+static void parse_format(const std::string& name, const std::string& layout)
+{
+  static const std::regex field_re("%(\\w+):(\\d+)");
+  std::map<std::string, field> fields;
+  std::vector<std::pair<std::string, unsigned> > order;
+  unsigned total = 0;
+
+  for (std::sregex_iterator m(layout.begin(), layout.end(), field_re), end; m != end; ++m) {
+    order.push_back(std::make_pair((*m)[1].str(), (unsigned) std::stoul((*m)[2].str())));
+    total += order.back().second;
+  }
+  if (total != 32)
+    fail("format is not 32 bits wide:", name);
+  for (size_t i = 0; i < order.size(); i++) {
+    total -= order[i].second;
+    fields[order[i].first] = field{ total, order[i].second };
+  }
+  formats[name] = fields;
+}
+
+static void parse(const char* path)
+{
+  static const std::regex format_re("ac_format\\s+(\\w+)\\s*=\\s*\"([^\"]*)\"");
+  static const std::regex instr_re("ac_instr\\s*<\\s*(\\w+)\\s*>\\s*([^;]*);");
+  static const std::regex decoder_re("(\\w+)\\.set_decoder\\s*\\(([^)]*)\\)");
+  static const std::regex constraint_re("(\\w+)\\s*=\\s*(\\w+)");
+  static const std::regex cycles_re("(\\w+)\\.set_cycles\\s*\\(\\s*(\\d+)\\s*\\)");
+
+  std::ifstream in(path);
+  if (!in)
+    fail("couldn't open", path);
+  std::stringstream text;
+  text << in.rdbuf();
+  const std::string s = text.str();
+  std::smatch m;
+
+  for (std::sregex_iterator i(s.begin(), s.end(), format_re), end; i != end; ++i)
+    parse_format((*i)[1].str(), (*i)[2].str());
+
+  for (std::sregex_iterator i(s.begin(), s.end(), instr_re), end; i != end; ++i) {
+    std::stringstream names((*i)[2].str());
+    std::string name;
+    while (std::getline(names, name, ',')) {
+      name.erase(0, name.find_first_not_of(" \t\n"));
+      name.erase(name.find_last_not_of(" \t\n") + 1);
+      instr in = { name, (*i)[1].str(), (unsigned) instrs.size() + 1, false, 0, 0, -1 };
+      instrs.push_back(in);
+    }
+  }
+
+  for (std::sregex_iterator i(s.begin(), s.end(), decoder_re), end; i != end; ++i) {
+    const std::string name = (*i)[1].str(), args = (*i)[2].str();
+    size_t k = 0;
+    while (k < instrs.size() && instrs[k].name != name)
+      k++;
+    if (k == instrs.size())
+      fail("set_decoder() of undeclared instruction", name);
+
+    instr& in = instrs[k];
+    in.decoded = true;
+    for (std::sregex_iterator c(args.begin(), args.end(), constraint_re), cend; c != cend; ++c) {
+      std::map<std::string, field>& fields = formats[in.format];
+      if (!fields.count((*c)[1].str()))
+        fail("unknown field in set_decoder() of", name);
+      const field& f = fields[(*c)[1].str()];
+      uint32_t mask = (uint32_t) (((1ull << f.width) - 1) << f.shift);
+      in.mask |= mask;
+      in.value |= ((uint32_t) std::stoul((*c)[2].str(), NULL, 0) << f.shift) & mask;
+    }
+  }
+
+  for (std::sregex_iterator i(s.begin(), s.end(), cycles_re), end; i != end; ++i) {
+    const std::string name = (*i)[1].str();
+    size_t k = 0;
+    while (k < instrs.size() && instrs[k].name != name)
+      k++;
+    if (k == instrs.size())
+      fail("set_cycles() of undeclared instruction", name);
+    instrs[k].cycles = std::stoi((*i)[2].str());
+  }
+
+  for (size_t k = 0; k < instrs.size(); k++)
+    if (!instrs[k].decoded)
+      fail("no set_decoder() for", instrs[k].name);
+}
+
+//! set_cycles() against mips_latency[]; returns the number of differences.
+static unsigned check_latencies()
+{
+  unsigned errors = 0;
+
+  for (size_t k = 0; k < instrs.size(); k++)
+    if (instrs[k].cycles >= 0 && (unsigned) instrs[k].cycles != mips_latency[instrs[k].id]) {
+      fprintf(stderr, "decoder_check: %s has set_cycles(%d), mips_latency[] says %u\n",
+              instrs[k].name.c_str(), instrs[k].cycles, mips_latency[instrs[k].id]);
+      errors++;
+    }
+  return errors;
+}
+
+static unsigned reference_decode(uint32_t w)
+{
+  for (size_t k = 0; k < instrs.size(); k++)
+    if ((w & instrs[k].mask) == instrs[k].value)
+      return instrs[k].id;
+  return MIPS_INVALID;
+}
+
+//! One word of every BENCH_EVERY checked goes to the benchmark sample.
+#define BENCH_EVERY 128
+#define BENCH_PASSES 8
+
+//! Best time per word of decode over BENCH_PASSES runs through words.
+static double bench(const std::vector<uint32_t>& words, unsigned (*decode)(uint32_t))
+{
+  double best = 0;
+  volatile unsigned sink = 0;
+
+  for (unsigned pass = 0; pass < BENCH_PASSES; pass++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    unsigned sum = 0;
+    for (size_t i = 0; i < words.size(); i++)
+      sum += decode(words[i]);
+    std::chrono::duration<double, std::nano> t = std::chrono::steady_clock::now() - start;
+    sink = sink + sum;
+    if (pass == 0 || t.count() < best)
+      best = t.count();
+  }
+  return best / words.size();
+}
+
+int main(int argc, char** argv)
+{
+  parse(argc > 1 ? argv[1] : "../mips_isa.ac");
+
+  if (instrs.size() != MIPS_NUM_INSTR) {
+    fprintf(stderr, "decoder_check: mips_isa.ac declares %u instructions, mips_decoder.H %u\n",
+            (unsigned) instrs.size(), (unsigned) MIPS_NUM_INSTR);
+    return EXIT_FAILURE;
+  }
+
+  unsigned latency_errors = check_latencies();
+  printf("decoder_check: %u latencies, %u mismatches\n", (unsigned) instrs.size(), latency_errors);
+
+  // Bits any set_decoder() line looks at, enumerated through all values.
+  uint32_t constrained = 0;
+  for (size_t k = 0; k < instrs.size(); k++)
+    constrained |= instrs[k].mask;
+
+  unsigned bits[32], nbits = 0;
+  for (unsigned b = 0; b < 32; b++)
+    if (constrained & (1u << b))
+      bits[nbits++] = b;
+
+  unsigned long long words = 0, errors = 0;
+  uint32_t random = 0x12345678;
+  std::vector<uint32_t> sample;
+
+  for (uint64_t n = 0; n < (1ull << nbits); n++) {
+    random = random * 1664525 + 1013904223;
+    uint32_t w = random & ~constrained;
+    for (unsigned b = 0; b < nbits; b++)
+      if (n & (1ull << b))
+        w |= 1u << bits[b];
+
+    unsigned expected = reference_decode(w), id = mips_decode_id(w);
+    words++;
+    if ((n & (BENCH_EVERY - 1)) == 0)
+      sample.push_back(w);
+    if (id != expected && errors++ < 16)
+      fprintf(stderr, "decoder_check: %#010x decodes to %u, mips_isa.ac says %u (%s)\n", w, id,
+              expected, expected ? instrs[expected - 1].name.c_str() : "invalid");
+  }
+
+  printf("decoder_check: %u instructions, %llu words, %llu mismatches\n",
+         (unsigned) instrs.size(), words, errors);
+  if (errors || latency_errors)
+    return EXIT_FAILURE;
+
+  double table_ns = bench(sample, mips_decode_id);
+  double reference_ns = bench(sample, reference_decode);
+  printf("decoder_check: %.2f ns/word table, %.2f ns/word reference, %.1fx\n",
+         table_ns, reference_ns, reference_ns / table_ns);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+/**
+ * @file      llsc_contention.c
+ *
+ *            The ArchC Team
+ *            http://www.archc.org/
+ *
+ *            Computer Systems Laboratory (LSC)
+ *            IC-UNICAMP
+ *            http://www.lsc.ic.unicamp.br/
+ *
+ * @brief     Lock contention microbenchmark for ll/sc (guest program).
+ *
+ * Every core of a multicore platform runs this program. The cores take
+ * an id with an ll/sc fetch-and-add, meet at a barrier, and then each
+ * increments one shared counter iterations times under an ll/sc
+ * spinlock. The contended loop is bracketed by the region of interest
+ * markers, so a simulator built with -DTIMING_MODEL reports the
+ * instructions and simulated time of each core; lock throughput is
+ * cores * iterations over the longest region time. Run it with 1, 2,
+ * 4, ... cores to see how throughput scales. The last core to finish
+ * checks the counter, and exits with status 1 if an update was lost.
+ *
+ * Build:  make -C tests llsc_contention.x   (needs a MIPS cross gcc)
+ * Usage:  llsc_contention.x <cores> [iterations]
+ *
+ * @attention Copyright (C) 2002-2006 --- The ArchC Team
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* The crt0 of every core clears .bss when it starts, possibly after
+   other cores have already used these, so keep them in .data. */
+#define SHARED __attribute__((section(".data")))
+
+static volatile int lock SHARED = 0;
+static volatile int next_core SHARED = 0;
+static volatile int arrived SHARED = 0;
+static volatile int finished SHARED = 0;
+static volatile unsigned counter SHARED = 0;
+
+/* ll/sc are MIPS II, sync too: let the assembler take them in MIPS I code */
+static int fetch_add(volatile int* p, int n)
+{
+  int old, tmp;
+
+  __asm__ volatile(".set push\n"
+                   ".set noreorder\n"
+                   ".set mips2\n"
+                   "1: ll    %0, 0(%2)\n"
+                   "   addu  %1, %0, %3\n"
+                   "   sc    %1, 0(%2)\n"
+                   "   beqz  %1, 1b\n"
+                   "   nop\n"
+                   "   sync\n"
+                   ".set pop\n"
+                   : "=&r" (old), "=&r" (tmp)
+                   : "r" (p), "r" (n)
+                   : "memory");
+  return old;
+}
+
+static void spin_lock(volatile int* l)
+{
+  int tmp;
+
+  __asm__ volatile(".set push\n"
+                   ".set noreorder\n"
+                   ".set mips2\n"
+                   "1: ll    %0, 0(%1)\n"
+                   "   bnez  %0, 1b\n"
+                   "   li    %0, 1\n"
+                   "   sc    %0, 0(%1)\n"
+                   "   beqz  %0, 1b\n"
+                   "   nop\n"
+                   "   sync\n"
+                   ".set pop\n"
+                   : "=&r" (tmp)
+                   : "r" (l)
+                   : "memory");
+}
+
+static void spin_unlock(volatile int* l)
+{
+  __asm__ volatile(".set push\n"
+                   ".set mips2\n"
+                   "sync\n"
+                   ".set pop\n"
+                   ::: "memory");
+  *l = 0;
+}
+
+/* Region of interest markers of mips_isa.cpp */
+#define ROI_BEGIN() __asm__ volatile("break 30" ::: "memory")
+#define ROI_END()   __asm__ volatile("break 31" ::: "memory")
+
+int main(int argc, char** argv)
+{
+  int cores, iterations, core, i;
+
+  if (argc < 2) {
+    printf("Usage: %s <cores> [iterations]\n", argv[0]);
+    return 2;
+  }
+  cores = atoi(argv[1]);
+  iterations = (argc > 2) ? atoi(argv[2]) : 10000;
+
+  core = fetch_add(&next_core, 1);
+  fetch_add(&arrived, 1);
+  while (arrived < cores)
+    ;
+
+  ROI_BEGIN();
+  for (i = 0; i < iterations; i++) {
+    spin_lock(&lock);
+    counter++;
+    spin_unlock(&lock);
+  }
+  ROI_END();
+
+  if (fetch_add(&finished, 1) == cores - 1) {
+    printf("llsc_contention: %d cores, %d iterations each, counter %u (expected %u)\n",
+           cores, iterations, counter, (unsigned) cores * iterations);
+    if (counter != (unsigned) cores * iterations)
+      return 1;
+  }
+  printf("llsc_contention: core %d done\n", core);
+  return 0;
+}